@@ -0,0 +1,100 @@
+// Decoding the prefix length diffs, shared by the decoders.
+// This header is private to the library.
+
+#ifndef FRENC_DIFF_H
+#define FRENC_DIFF_H
+
+static const bool bigdiff[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#define UNLIKELY(cond) __builtin_expect(cond, 0)
+
+#define CKBAD(cond)			\
+    do {				\
+	if (check && UNLIKELY(cond))	\
+	    return FRENC_ERR_DATA;	\
+    } while (0)
+
+#define APPLY_NEGATIVE_DIFF(diff)	\
+    do {				\
+	size_t absdiff = -diff;		\
+	CKBAD(absdiff > olen);		\
+	len = olen - absdiff;		\
+    } while (0)
+
+#define APPLY_NONNEGATIVE_DIFF(diff)	\
+    do {				\
+	len = olen + diff;		\
+	CKBAD(len > INT_MAX);		\
+    } while (0)
+
+// Decode the diff at *encp, advancing the pointer, and apply it
+// to the previous prefix length olen.  Returns the new prefix length,
+// or FRENC_ERR_DATA (only if check is true).  The caller must ensure
+// that at least one byte is available.
+static inline size_t getlen(const char **encp, const char *end,
+			    size_t olen, bool check)
+{
+    const char *enc = *encp;
+    int diff = *enc++;
+    size_t len;
+    if (UNLIKELY(bigdiff[(unsigned char) diff])) {
+	int left = end - enc;
+	if (diff == 127) {
+	    CKBAD(left < 2);
+	    diff += (unsigned char) *enc++;
+	    APPLY_NONNEGATIVE_DIFF(diff);
+	}
+	else if (diff == -127) {
+	    CKBAD(left < 2);
+	    diff -= (unsigned char) *enc++;
+	    APPLY_NEGATIVE_DIFF(diff);
+	}
+	else {
+	    assert(diff == -128);
+	    CKBAD(left < 3);
+	    union { short s16; unsigned short u16; } u;
+	    memcpy(&u, enc, 2);
+	    enc += 2;
+	    u.u16 = le16toh(u.u16);
+	    if (u.s16 >= 0) {
+		diff = u.s16 + (DIFF2_HI+1);
+		APPLY_NONNEGATIVE_DIFF(diff);
+	    }
+	    else {
+		diff = u.s16 + (DIFF2_LO-1);
+		if (diff < DIFF3_LO)
+		    len = 0;
+		else
+		    APPLY_NEGATIVE_DIFF(diff);
+	    }
+	}
+    }
+    else {
+	CKBAD(enc == end);
+	if (diff < 0)
+	    APPLY_NEGATIVE_DIFF(diff);
+	else
+	    APPLY_NONNEGATIVE_DIFF(diff);
+    }
+    *encp = enc;
+    return len;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "frenc.h"
+
+// This program compares the trie (frdec_trie) against a hash table
+// built over v[] after frdecl.  It reads sorted lines from the standard
+// input (e.g. LC_ALL=C sort), and reports the build time and the time
+// of exact lookups of all the strings, in random order.
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline uint64_t strhash(const char *s, size_t len)
+{
+    uint64_t h = 14695981039346656037u;
+    for (size_t i = 0; i < len; i++)
+	h = (h ^ (unsigned char) s[i]) * 1099511628211u;
+    return h;
+}
+
+struct hash {
+    size_t mask;
+    size_t *slot; // index + 1, 0 if empty
+};
+
+static void hash_build(struct hash *ht, char **v, unsigned *ll, size_t n)
+{
+    size_t slots = 16;
+    while (slots < 2 * n)
+	slots *= 2;
+    ht->mask = slots - 1;
+    ht->slot = calloc(slots, sizeof *ht->slot);
+    assert(ht->slot);
+    for (size_t i = 0; i < n; i++) {
+	size_t h = strhash(v[i], ll[i]) & ht->mask;
+	while (ht->slot[h])
+	    h = (h + 1) & ht->mask;
+	ht->slot[h] = i + 1;
+    }
+}
+
+static size_t hash_find(const struct hash *ht, char **v, unsigned *ll,
+			size_t n, const char *s, size_t len)
+{
+    size_t h = strhash(s, len) & ht->mask;
+    for (; ht->slot[h]; h = (h + 1) & ht->mask) {
+	size_t i = ht->slot[h] - 1;
+	if (ll[i] == len && memcmp(v[i], s, len) == 0)
+	    return i;
+    }
+    return n;
+}
+
+int main(void)
+{
+    size_t n = 0;
+    char **in = NULL;
+    char *line = NULL;
+    size_t alloc_size = 0;
+    ssize_t len;
+    while ((len = getline(&line, &alloc_size, stdin)) >= 0) {
+	if (len > 0 && line[len-1] == '\n')
+	    line[--len] = '\0';
+	if ((n % 1024) == 0)
+	    in = realloc(in, sizeof(*in) * (n + 1024));
+	assert(in);
+	in[n++] = line;
+	line = NULL;
+	alloc_size = 0;
+    }
+    if (n == 0) {
+	fprintf(stderr, "frbench: empty input\n");
+	return 1;
+    }
+    void *enc;
+    size_t encsize = frenc(in, n, &enc);
+    assert(encsize < FRENC_ERROR);
+    // the lookup keys, in random order
+    size_t *perm = malloc(n * sizeof *perm);
+    assert(perm);
+    for (size_t i = 0; i < n; i++)
+	perm[i] = i;
+    srand(1);
+    for (size_t i = n - 1; i > 0; i--) {
+	size_t j = rand() % (i + 1);
+	size_t x = perm[i];
+	perm[i] = perm[j];
+	perm[j] = x;
+    }
+    size_t *klen = malloc(n * sizeof *klen);
+    assert(klen);
+    for (size_t i = 0; i < n; i++)
+	klen[i] = strlen(in[perm[i]]);
+    // the trie
+    double t0 = now();
+    struct frtrie *t;
+    size_t rc = frdec_trie(enc, encsize, &t);
+    if (rc >= FRENC_ERROR) {
+	fprintf(stderr, "frbench: frdec_trie failed (unsorted input?)\n");
+	return 1;
+    }
+    double t1 = now();
+    size_t found = 0;
+    for (size_t i = 0; i < n; i++)
+	found += frtrie_find(t, in[perm[i]], klen[i]) < n;
+    double t2 = now();
+    assert(found == n);
+    printf("trie: build %.1f ms, lookup %.3f us\n",
+	   (t1 - t0) * 1e3, (t2 - t1) * 1e6 / n);
+    frtrie_free(t);
+    // the hash table
+    t0 = now();
+    char **v;
+    unsigned *ll;
+    rc = frdecl(enc, encsize, &v, &ll);
+    assert(rc == n);
+    struct hash ht;
+    hash_build(&ht, v, ll, n);
+    t1 = now();
+    found = 0;
+    for (size_t i = 0; i < n; i++)
+	found += hash_find(&ht, v, ll, n, in[perm[i]], klen[i]) < n;
+    t2 = now();
+    assert(found == n);
+    printf("hash: build %.1f ms, lookup %.3f us\n",
+	   (t1 - t0) * 1e3, (t2 - t1) * 1e6 / n);
+    free(ht.slot);
+    free(v);
+    free(enc);
+    free(perm);
+    free(klen);
+    for (size_t i = 0; i < n; i++)
+	free(in[i]);
+    free(in);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <endian.h>
+#include "frenc.h"
+
+// The filter is a split block Bloom filter: an array of 256-bit blocks,
+// each made of eight 32-bit words.  A string selects one block, and sets
+// (or tests) one bit in each of its words.  Thus a lookup touches only
+// one block, i.e. a single cache line.  With 16 bits per string, the
+// false positive rate is about 0.1%.
+#define BLOCK_WORDS 8
+#define BLOCK_SIZE (BLOCK_WORDS * 4)
+#define BITS_PER_STRING 16
+
+// MurmurHash64A, with the input read as little-endian, so that
+// the filter built on one platform can be used on another.
+static uint64_t hash64(const char *s, size_t len)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995;
+    const int r = 47;
+    uint64_t h = len * m;
+    const char *end = s + (len & ~(size_t) 7);
+    while (s < end) {
+	uint64_t k;
+	memcpy(&k, s, 8);
+	s += 8;
+	k = le64toh(k);
+	k *= m;
+	k ^= k >> r;
+	k *= m;
+	h ^= k;
+	h *= m;
+    }
+    switch (len & 7) {
+    case 7: h ^= (uint64_t) (unsigned char) s[6] << 48; // fall through
+    case 6: h ^= (uint64_t) (unsigned char) s[5] << 40; // fall through
+    case 5: h ^= (uint64_t) (unsigned char) s[4] << 32; // fall through
+    case 4: h ^= (uint64_t) (unsigned char) s[3] << 24; // fall through
+    case 3: h ^= (uint64_t) (unsigned char) s[2] << 16; // fall through
+    case 2: h ^= (uint64_t) (unsigned char) s[1] << 8;  // fall through
+    case 1: h ^= (uint64_t) (unsigned char) s[0];
+	h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+// The high half of the hash selects the block, and the low half,
+// multiplied by these odd constants, selects a bit in each word.
+static const uint32_t salt[BLOCK_WORDS] = {
+    0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+    0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31,
+};
+
+static inline const uint32_t *getblock(const void *filt, size_t nblocks,
+				       uint64_t h)
+{
+    uint64_t i = ((h >> 32) * nblocks) >> 32;
+    return (const uint32_t *) filt + i * BLOCK_WORDS;
+}
+
+size_t frenc_bloom(char **v, size_t n, void **filtp)
+{
+    assert(n > 0);
+    assert(v);
+    assert(filtp);
+    size_t nblocks = n / (BLOCK_SIZE * 8 / BITS_PER_STRING) + 1;
+    if (nblocks > UINT32_MAX)
+	return FRENC_ERR_RANGE;
+    uint32_t *filt = calloc(nblocks, BLOCK_SIZE);
+    if (filt == NULL)
+	return FRENC_ERR_MALLOC;
+    for (size_t i = 0; i < n; i++) {
+	uint64_t h = hash64(v[i], strlen(v[i]));
+	uint32_t *block = (uint32_t *) getblock(filt, nblocks, h);
+	for (int j = 0; j < BLOCK_WORDS; j++)
+	    block[j] |= htole32(1u << (((uint32_t) h * salt[j]) >> 27));
+    }
+    *filtp = filt;
+    return nblocks * BLOCK_SIZE;
+}
+
+int frbloom_maybe_contains(const void *filt, size_t filtsize,
+			   const char *s, size_t len)
+{
+    assert(filtsize > 0);
+    assert(filtsize % BLOCK_SIZE == 0);
+    assert(filt);
+    uint64_t h = hash64(s, len);
+    const uint32_t *block = getblock(filt, filtsize / BLOCK_SIZE, h);
+    uint32_t block32[BLOCK_WORDS];
+    memcpy(block32, block, BLOCK_SIZE);
+    for (int j = 0; j < BLOCK_WORDS; j++) {
+	uint32_t bit = 1u << (((uint32_t) h * salt[j]) >> 27);
+	if (!(le32toh(block32[j]) & bit))
+	    return 0;
+    }
+    return 1;
+}
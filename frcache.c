@@ -0,0 +1,331 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include "frenc.h"
+
+// The cache is split into shards, each protected by its own mutex,
+// so that threads which look up different blobs rarely contend.
+// A shard is a hash table of decoded entries, plus an array of the
+// same entries swept by the CLOCK hand on eviction.  The byte budget
+// is global: the total size is kept in an atomic counter, and when
+// it gets over the budget, the shards are swept in turn.
+#define NSHARDS 16
+
+struct entry {
+    const void *enc;
+    size_t encsize;
+    // the result of frdecl
+    size_t n;
+    char **v;
+    unsigned *ll;
+    // the size of the malloc chunk v[]
+    size_t bytes;
+    // the number of callers currently holding the entry
+    unsigned refcnt;
+    // the CLOCK "recently used" bit
+    bool used;
+    // whether the entry is in the cache (too big or removed entries
+    // are not, and are freed when released)
+    bool cached;
+    // the index in the clock array
+    size_t slot;
+    struct entry *next;
+    struct shard *shard;
+};
+
+struct shard {
+    pthread_mutex_t mutex;
+    struct entry **buckets;
+    size_t nbuckets;
+    struct entry **clock;
+    size_t count;
+    size_t alloc;
+    size_t hand;
+    size_t hits;
+    size_t misses;
+    struct frenc_cache *cache;
+};
+
+struct frenc_cache {
+    struct shard shards[NSHARDS];
+    size_t budget;
+    // the total size of the cached entries, updated atomically
+    size_t bytes;
+    // the shard to start the next sweep with
+    unsigned sweep;
+};
+
+static inline uint64_t keyhash(const void *enc, size_t encsize)
+{
+    uint64_t h = (uintptr_t) enc ^ ((uint64_t) encsize << 32);
+    h *= 0x9e3779b97f4a7c15;
+    return h ^ h >> 29;
+}
+
+static inline size_t getbytes(struct frenc_cache *cache)
+{
+    return __atomic_load_n(&cache->bytes, __ATOMIC_RELAXED);
+}
+
+struct frenc_cache *frenc_cache_new(size_t budget)
+{
+    struct frenc_cache *cache = calloc(1, sizeof *cache);
+    if (cache == NULL)
+	return NULL;
+    cache->budget = budget;
+    for (int i = 0; i < NSHARDS; i++) {
+	struct shard *sh = &cache->shards[i];
+	pthread_mutex_init(&sh->mutex, NULL);
+	sh->cache = cache;
+    }
+    return cache;
+}
+
+static void freeentry(struct entry *e)
+{
+    free(e->v);
+    free(e);
+}
+
+void frenc_cache_free(struct frenc_cache *cache)
+{
+    if (cache == NULL)
+	return;
+    for (int i = 0; i < NSHARDS; i++) {
+	struct shard *sh = &cache->shards[i];
+	for (size_t j = 0; j < sh->count; j++) {
+	    assert(sh->clock[j]->refcnt == 0);
+	    freeentry(sh->clock[j]);
+	}
+	free(sh->buckets);
+	free(sh->clock);
+	pthread_mutex_destroy(&sh->mutex);
+    }
+    free(cache);
+}
+
+static struct entry *lookup(struct shard *sh, uint64_t h,
+			    const void *enc, size_t encsize)
+{
+    if (sh->nbuckets == 0)
+	return NULL;
+    struct entry *e = sh->buckets[h & (sh->nbuckets - 1)];
+    while (e && !(e->enc == enc && e->encsize == encsize))
+	e = e->next;
+    return e;
+}
+
+static void unlink_entry(struct shard *sh, struct entry *e)
+{
+    uint64_t h = keyhash(e->enc, e->encsize);
+    struct entry **pe = &sh->buckets[h & (sh->nbuckets - 1)];
+    while (*pe != e)
+	pe = &(*pe)->next;
+    *pe = e->next;
+    // swap-remove from the clock array
+    struct entry *last = sh->clock[--sh->count];
+    sh->clock[e->slot] = last;
+    last->slot = e->slot;
+    __atomic_fetch_sub(&sh->cache->bytes, e->bytes, __ATOMIC_RELAXED);
+    e->cached = 0;
+}
+
+// Sweep the CLOCK hand of the shard while the cache is over budget.
+// Entries held by callers cannot be evicted.
+static void evict(struct shard *sh)
+{
+    struct frenc_cache *cache = sh->cache;
+    size_t idle = 0;
+    while (getbytes(cache) > cache->budget && sh->count &&
+	    idle < 2 * sh->count) {
+	if (sh->hand >= sh->count)
+	    sh->hand = 0;
+	struct entry *e = sh->clock[sh->hand];
+	if (e->refcnt) {
+	    sh->hand++;
+	    idle++;
+	}
+	else if (e->used) {
+	    e->used = 0;
+	    sh->hand++;
+	    idle++;
+	}
+	else {
+	    unlink_entry(sh, e);
+	    freeentry(e);
+	    idle = 0;
+	}
+    }
+}
+
+// Bring the cache within the budget, sweeping the shards in turn
+// (one lock at a time).  If all the entries are held by callers,
+// the budget is exceeded until they are released.
+static void shrink(struct frenc_cache *cache)
+{
+    unsigned start = __atomic_fetch_add(&cache->sweep, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < NSHARDS && getbytes(cache) > cache->budget; i++) {
+	struct shard *sh = &cache->shards[(start + i) % NSHARDS];
+	pthread_mutex_lock(&sh->mutex);
+	evict(sh);
+	pthread_mutex_unlock(&sh->mutex);
+    }
+}
+
+static bool insert(struct shard *sh, uint64_t h, struct entry *e)
+{
+    if (sh->count == sh->alloc) {
+	size_t alloc = sh->alloc ? 2 * sh->alloc : 16;
+	struct entry **clock = realloc(sh->clock, alloc * sizeof *clock);
+	if (clock == NULL)
+	    return 0;
+	sh->clock = clock;
+	sh->alloc = alloc;
+    }
+    if (sh->count >= sh->nbuckets) {
+	size_t nbuckets = sh->nbuckets ? 2 * sh->nbuckets : 16;
+	struct entry **buckets = calloc(nbuckets, sizeof *buckets);
+	if (buckets == NULL)
+	    return 0;
+	for (size_t j = 0; j < sh->count; j++) {
+	    struct entry *x = sh->clock[j];
+	    uint64_t hx = keyhash(x->enc, x->encsize);
+	    x->next = buckets[hx & (nbuckets - 1)];
+	    buckets[hx & (nbuckets - 1)] = x;
+	}
+	free(sh->buckets);
+	sh->buckets = buckets;
+	sh->nbuckets = nbuckets;
+    }
+    e->next = sh->buckets[h & (sh->nbuckets - 1)];
+    sh->buckets[h & (sh->nbuckets - 1)] = e;
+    e->slot = sh->count;
+    sh->clock[sh->count++] = e;
+    __atomic_fetch_add(&sh->cache->bytes, e->bytes, __ATOMIC_RELAXED);
+    e->cached = 1;
+    return 1;
+}
+
+static inline struct shard *getshard(struct frenc_cache *cache, uint64_t h)
+{
+    return &cache->shards[h >> 60 & (NSHARDS - 1)];
+}
+
+size_t frenc_cache_get(struct frenc_cache *cache,
+		       const void *enc, size_t encsize,
+		       char ***vp, unsigned **llp, void **refp)
+{
+    assert(cache);
+    assert(vp);
+    assert(refp);
+    uint64_t h = keyhash(enc, encsize);
+    struct shard *sh = getshard(cache, h);
+    pthread_mutex_lock(&sh->mutex);
+    struct entry *e = lookup(sh, h, enc, encsize);
+    if (e) {
+	sh->hits++;
+	e->refcnt++;
+	e->used = 1;
+	pthread_mutex_unlock(&sh->mutex);
+	goto found;
+    }
+    sh->misses++;
+    pthread_mutex_unlock(&sh->mutex);
+    // decode without holding the lock
+    struct entry *ne = malloc(sizeof *ne);
+    if (ne == NULL)
+	return FRENC_ERR_MALLOC;
+    size_t n = frdecl(enc, encsize, &ne->v, &ne->ll);
+    if (n >= FRENC_ERROR) {
+	free(ne);
+	return n;
+    }
+    ne->enc = enc;
+    ne->encsize = encsize;
+    ne->n = n;
+    ne->bytes = (char *) (ne->v[n-1] + ne->ll[n-1] + 1) - (char *) ne->v;
+    ne->refcnt = 0;
+    ne->used = 1;
+    ne->cached = 0;
+    ne->shard = sh;
+    pthread_mutex_lock(&sh->mutex);
+    // another thread may have decoded the same blob in the meantime
+    e = lookup(sh, h, enc, encsize);
+    if (e)
+	freeentry(ne);
+    else {
+	e = ne;
+	if (e->bytes <= cache->budget)
+	    insert(sh, h, e);
+    }
+    // the entry is held and cannot be evicted itself
+    e->refcnt++;
+    e->used = 1;
+    pthread_mutex_unlock(&sh->mutex);
+    shrink(cache);
+found:
+    *vp = e->v;
+    if (llp)
+	*llp = e->ll;
+    *refp = e;
+    return e->n;
+}
+
+void frenc_cache_put(void *ref)
+{
+    struct entry *e = ref;
+    assert(e);
+    struct shard *sh = e->shard;
+    struct frenc_cache *cache = sh->cache;
+    pthread_mutex_lock(&sh->mutex);
+    assert(e->refcnt > 0);
+    bool dead = --e->refcnt == 0 && !e->cached;
+    bool over = e->refcnt == 0 && getbytes(cache) > cache->budget;
+    pthread_mutex_unlock(&sh->mutex);
+    if (dead)
+	freeentry(e);
+    else if (over)
+	shrink(cache);
+}
+
+void frenc_cache_remove(struct frenc_cache *cache,
+			const void *enc, size_t encsize)
+{
+    assert(cache);
+    uint64_t h = keyhash(enc, encsize);
+    struct shard *sh = getshard(cache, h);
+    pthread_mutex_lock(&sh->mutex);
+    struct entry *e = lookup(sh, h, enc, encsize);
+    bool dead = 0;
+    if (e) {
+	unlink_entry(sh, e);
+	// if held, the entry is freed when released
+	dead = e->refcnt == 0;
+    }
+    pthread_mutex_unlock(&sh->mutex);
+    if (dead)
+	freeentry(e);
+}
+
+void frenc_cache_stats(struct frenc_cache *cache,
+		       size_t *hits, size_t *misses, size_t *bytes)
+{
+    assert(cache);
+    size_t h = 0, m = 0;
+    for (int i = 0; i < NSHARDS; i++) {
+	struct shard *sh = &cache->shards[i];
+	pthread_mutex_lock(&sh->mutex);
+	h += sh->hits;
+	m += sh->misses;
+	pthread_mutex_unlock(&sh->mutex);
+    }
+    if (hits)
+	*hits = h;
+    if (misses)
+	*misses = m;
+    if (bytes)
+	*bytes = getbytes(cache);
+}
@@ -0,0 +1,437 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <fnmatch.h>
+#include "frenc.h"
+
+// This program checks the library routines against brute force
+// on random sets of path-like strings; it is run by "make check".
+
+static unsigned long long rnd_state = 1;
+
+static unsigned rnd(unsigned n)
+{
+    rnd_state = rnd_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (rnd_state >> 33) % n;
+}
+
+// Make up a path, with a few directory levels and an extension.
+static char *genpath(void)
+{
+    static const char *dirs[] = {
+	"usr", "lib", "lib64", "bin", "share", "doc", "python3", "site",
+	"x86_64-linux-gnu", "include", "locale", "LC_MESSAGES", "a", "b",
+    };
+    static const char *exts[] = {
+	"", ".so", ".so.1", ".h", ".py", ".pyc", ".mo", ".gz", "/__init__.py",
+    };
+    char buf[256], *p = buf;
+    int depth = 1 + rnd(5);
+    for (int i = 0; i < depth; i++)
+	p += sprintf(p, "/%s", dirs[rnd(sizeof dirs / sizeof *dirs)]);
+    p += sprintf(p, "/f%u%s", rnd(100), exts[rnd(sizeof exts / sizeof *exts)]);
+    return strdup(buf);
+}
+
+static int cmpstr(const void *p1, const void *p2)
+{
+    return strcmp(*(char **) p1, *(char **) p2);
+}
+
+// Make up a sorted set of n distinct strings.
+static size_t genset(char **v, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+	v[i] = genpath();
+    qsort(v, n, sizeof *v, cmpstr);
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+	if (m && strcmp(v[m-1], v[i]) == 0)
+	    free(v[i]);
+	else
+	    v[m++] = v[i];
+    }
+    return m;
+}
+
+static void freeset(char **v, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+	free(v[i]);
+}
+
+#define MAXSET 2000
+
+static void check_bloom(void)
+{
+    static char *v[MAXSET];
+    size_t fp = 0, q = 0;
+    for (int iter = 0; iter < 100; iter++) {
+	size_t n = genset(v, 1 + rnd(MAXSET));
+	void *filt;
+	size_t filtsize = frenc_bloom(v, n, &filt);
+	assert(filtsize < FRENC_ERROR);
+	// no false negatives
+	for (size_t i = 0; i < n; i++)
+	    assert(frbloom_maybe_contains(filt, filtsize, v[i], strlen(v[i])));
+	// few false positives
+	for (int i = 0; i < 1000; i++) {
+	    char buf[32];
+	    int len = sprintf(buf, "/absent/%d", i);
+	    fp += frbloom_maybe_contains(filt, filtsize, buf, len);
+	    q++;
+	}
+	free(filt);
+	freeset(v, n);
+    }
+    assert(fp * 100 < q);
+}
+
+// Check the decoded strings against the original set.
+static void cmpset(char **v, size_t n, char **dv, unsigned *dl, size_t dn)
+{
+    assert(dn == n);
+    for (size_t i = 0; i < n; i++)
+	assert(dl[i] == strlen(v[i]) && memcmp(dv[i], v[i], dl[i] + 1) == 0);
+    assert(dv[n] == NULL);
+}
+
+#define NBLOBS 64
+static char *cache_v[NBLOBS][64];
+static size_t cache_n[NBLOBS];
+static void *cache_enc[NBLOBS];
+static size_t cache_encsize[NBLOBS];
+static struct frenc_cache *cache;
+
+static void *cache_thread(void *arg)
+{
+    unsigned seed = (unsigned long) arg;
+    for (int i = 0; i < 10000; i++) {
+	seed = seed * 1103515245 + 12345;
+	int b = (seed >> 16) % NBLOBS;
+	char **v;
+	unsigned *ll;
+	void *ref;
+	size_t n = frenc_cache_get(cache, cache_enc[b], cache_encsize[b],
+				   &v, &ll, &ref);
+	cmpset(cache_v[b], cache_n[b], v, ll, n);
+	frenc_cache_put(ref);
+    }
+    return NULL;
+}
+
+static void check_cache(void)
+{
+    size_t maxbytes = 0;
+    for (int b = 0; b < NBLOBS; b++) {
+	cache_n[b] = genset(cache_v[b], 1 + rnd(64));
+	cache_encsize[b] = frenc(cache_v[b], cache_n[b], &cache_enc[b]);
+	assert(cache_encsize[b] < FRENC_ERROR);
+	char **v;
+	frdec(cache_enc[b], cache_encsize[b], &v);
+	size_t bytes = (char *) (v[cache_n[b]-1] +
+				 strlen(v[cache_n[b]-1]) + 1) - (char *) v;
+	bytes += cache_n[b] * sizeof(unsigned);
+	if (bytes > maxbytes)
+	    maxbytes = bytes;
+	free(v);
+    }
+    // a blob bigger than budget/16, but within the budget, gets cached
+    size_t budget = 3 * maxbytes;
+    cache = frenc_cache_new(budget);
+    assert(cache);
+    size_t hits, misses, bytes;
+    for (int i = 0; i < 10; i++) {
+	for (int b = 0; b < 3; b++) {
+	    char **v;
+	    unsigned *ll;
+	    void *ref;
+	    size_t n = frenc_cache_get(cache, cache_enc[b], cache_encsize[b],
+				       &v, &ll, &ref);
+	    cmpset(cache_v[b], cache_n[b], v, ll, n);
+	    frenc_cache_put(ref);
+	}
+    }
+    frenc_cache_stats(cache, &hits, &misses, &bytes);
+    assert(misses == 3 && hits == 27);
+    assert(bytes <= budget);
+    // many threads, the budget is respected
+    pthread_t t[8];
+    for (long i = 0; i < 8; i++)
+	pthread_create(&t[i], NULL, cache_thread, (void *) i);
+    for (int i = 0; i < 8; i++)
+	pthread_join(t[i], NULL);
+    frenc_cache_stats(cache, &hits, &misses, &bytes);
+    assert(hits > 0 && bytes <= budget);
+    frenc_cache_free(cache);
+    // a removed blob is decoded anew, even at the same address
+    cache = frenc_cache_new(budget);
+    char *va[] = { "aaaa" }, *vb[] = { "bbbb" };
+    void *enca, *encb;
+    size_t size = frenc(va, 1, &enca);
+    size_t sizeb = frenc(vb, 1, &encb);
+    assert(sizeb == size);
+    char **v;
+    void *ref, *ref2;
+    frenc_cache_get(cache, enca, size, &v, NULL, &ref);
+    assert(strcmp(v[0], "aaaa") == 0);
+    frenc_cache_remove(cache, enca, size);
+    // still held
+    assert(strcmp(v[0], "aaaa") == 0);
+    memcpy(enca, encb, size);
+    frenc_cache_get(cache, enca, size, &v, NULL, &ref2);
+    assert(strcmp(v[0], "bbbb") == 0);
+    frenc_cache_put(ref);
+    frenc_cache_put(ref2);
+    frenc_cache_stats(cache, &hits, &misses, NULL);
+    assert(hits == 0 && misses == 2);
+    frenc_cache_free(cache);
+    free(enca);
+    free(encb);
+    for (int b = 0; b < NBLOBS; b++) {
+	freeset(cache_v[b], cache_n[b]);
+	free(cache_enc[b]);
+    }
+}
+
+// Brute force prefix search: the strings are sorted, so the matches
+// make up a range.
+static size_t prefix_range(char **v, size_t n, const char *s, size_t len,
+			   size_t *hip)
+{
+    size_t lo = 0;
+    while (lo < n && strncmp(v[lo], s, len) < 0)
+	lo++;
+    size_t hi = lo;
+    while (hi < n && strncmp(v[hi], s, len) == 0)
+	hi++;
+    *hip = hi;
+    return lo;
+}
+
+static void check_trie1(char **v, size_t n)
+{
+    void *enc;
+    size_t encsize = frenc(v, n, &enc);
+    assert(encsize < FRENC_ERROR);
+    struct frtrie *t;
+    size_t rc = frdec_trie(enc, encsize, &t);
+    assert(rc == n);
+    cmpset(v, n, t->v, t->ll, t->n);
+    for (size_t i = 0; i < n; i++) {
+	size_t len = strlen(v[i]);
+	assert(frtrie_find(t, v[i], len) == i);
+	// a random prefix
+	size_t plen = rnd(len + 1);
+	size_t hi, xhi;
+	size_t lo = frtrie_prefix(t, v[i], plen, &hi);
+	size_t xlo = prefix_range(v, n, v[i], plen, &xhi);
+	assert(lo == xlo && hi == xhi);
+    }
+    // absent strings
+    assert(frtrie_find(t, "/absent", 7) == n);
+    assert(frtrie_find(t, v[0], strlen(v[0]) + 1) == n);
+    size_t hi;
+    size_t lo = frtrie_prefix(t, "/absent", 7, &hi);
+    assert(lo == hi);
+    frtrie_free(t);
+    // corrupt data must not crash the decoder
+    for (int i = 0; i < 10; i++) {
+	char *bad = malloc(encsize);
+	memcpy(bad, enc, encsize);
+	bad[rnd(encsize)] ^= 1 << rnd(8);
+	rc = frdec_trie(bad, encsize, &t);
+	if (rc < FRENC_ERROR)
+	    frtrie_free(t);
+	free(bad);
+    }
+    free(enc);
+}
+
+static void check_trie(void)
+{
+    static char *v[MAXSET];
+    for (int iter = 0; iter < 100; iter++) {
+	size_t n = genset(v, 1 + rnd(MAXSET));
+	check_trie1(v, n);
+	freeset(v, n);
+    }
+    // the prefix longer than DIFF3_HI is truncated on encoding
+    size_t big = 40000;
+    for (int i = 0; i < 3; i++) {
+	v[i] = malloc(big + 2);
+	memset(v[i], 'x', big);
+	v[i][big] = 'a' + i;
+	v[i][big+1] = '\0';
+    }
+    v[0][big] = '\0';
+    check_trie1(v, 3);
+    // unsorted strings are rejected
+    char *tmp = v[1];
+    v[1] = v[2];
+    v[2] = tmp;
+    void *enc;
+    size_t encsize = frenc(v, 3, &enc);
+    assert(encsize < FRENC_ERROR);
+    struct frtrie *t;
+    size_t rc = frdec_trie(enc, encsize, &t);
+    assert(rc == FRENC_ERR_DATA);
+    free(enc);
+    freeset(v, 3);
+}
+
+static void check_delta(void)
+{
+    static char *v0[MAXSET], *v1[2*MAXSET];
+    for (int iter = 0; iter < 100; iter++) {
+	size_t n0 = genset(v0, 1 + rnd(MAXSET));
+	// keep some strings of the base, and add some new ones
+	// (every 20th set is empty)
+	size_t n1 = 0;
+	for (size_t i = 0; i < n0; i++)
+	    if (iter % 20 && rnd(4))
+		v1[n1++] = strdup(v0[i]);
+	n1 += iter % 10 ? genset(v1 + n1, rnd(MAXSET / 4)) : 0;
+	qsort(v1, n1, sizeof *v1, cmpstr);
+	size_t m = 0;
+	for (size_t i = 0; i < n1; i++) {
+	    if (m && strcmp(v1[m-1], v1[i]) == 0)
+		free(v1[i]);
+	    else
+		v1[m++] = v1[i];
+	}
+	n1 = m;
+	void *base, *enc;
+	size_t basesize = frenc(v0, n0, &base);
+	assert(basesize < FRENC_ERROR);
+	size_t encsize = frenc_delta(base, basesize, v1, n1, &enc);
+	assert(encsize < FRENC_ERROR);
+	char **v;
+	unsigned *ll;
+	size_t n = frdec_delta(base, basesize, enc, encsize, &v, &ll);
+	// the empty set is not an error
+	cmpset(v1, n1, v, ll, n);
+	free(v);
+	// corrupt data must not crash the decoder
+	for (int i = 0; i < 10 && encsize > 4; i++) {
+	    char *bad = malloc(encsize);
+	    memcpy(bad, enc, encsize);
+	    bad[4 + rnd(encsize - 4)] ^= 1 << rnd(8);
+	    n = frdec_delta(base, basesize, bad, encsize, &v, NULL);
+	    if (n < FRENC_ERROR)
+		free(v);
+	    free(bad);
+	}
+	// unsorted sets are rejected
+	if (n1 > 1) {
+	    char *tmp = v1[0];
+	    v1[0] = v1[n1-1];
+	    v1[n1-1] = tmp;
+	    void *enc2;
+	    size_t rc = frenc_delta(base, basesize, v1, n1, &enc2);
+	    assert(rc == FRENC_ERR_DATA);
+	}
+	free(base);
+	free(enc);
+	freeset(v0, n0);
+	freeset(v1, n1);
+    }
+}
+
+// Brute force predicate.
+static bool pred_match(const struct frenc_pred *pred, const char *s)
+{
+    size_t len = strlen(s), plen = pred->pat ? strlen(pred->pat) : 0;
+    switch (pred->type) {
+    case FRENC_PRED_PREFIX:
+	return strncmp(s, pred->pat, plen) == 0;
+    case FRENC_PRED_SUFFIX:
+	return len >= plen && strcmp(s + len - plen, pred->pat) == 0;
+    case FRENC_PRED_GLOB:
+	return fnmatch(pred->pat, s, pred->flags & ~FRENC_PRED_SORTED) == 0;
+    default:
+	return pred->func(s, len, 0, pred->arg);
+    }
+}
+
+static int has_digit7(const char *s, size_t slen, size_t len, void *arg)
+{
+    (void) len, (void) arg;
+    return memchr(s, '7', slen) != NULL;
+}
+
+static void check_pred1(char **v, size_t n, const void *enc, size_t encsize,
+			const struct frenc_pred *pred)
+{
+    char **fv;
+    unsigned *fl;
+    size_t fn = frdec_filter(enc, encsize, pred, &fv, &fl);
+    assert(fn < FRENC_ERROR);
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+	if (!pred_match(pred, v[i]))
+	    continue;
+	assert(m < fn && fl[m] == strlen(v[i]) &&
+	       memcmp(fv[m], v[i], fl[m] + 1) == 0);
+	m++;
+    }
+    assert(m == fn && fv[fn] == NULL);
+    free(fv);
+}
+
+static void check_pred(void)
+{
+    static const struct {
+	int type;
+	const char *pat;
+	int flags;
+    } preds[] = {
+	{ FRENC_PRED_PREFIX, "", 0 },
+	{ FRENC_PRED_PREFIX, "/usr/lib", 0 },
+	{ FRENC_PRED_PREFIX, "/usr/lib", FRENC_PRED_SORTED },
+	{ FRENC_PRED_PREFIX, "/b/", FRENC_PRED_SORTED },
+	{ FRENC_PRED_SUFFIX, ".so.1", 0 },
+	{ FRENC_PRED_SUFFIX, "/__init__.py", 0 },
+	{ FRENC_PRED_GLOB, "/usr/*/f1*", 0 },
+	{ FRENC_PRED_GLOB, "/usr/*/f1*", FNM_PATHNAME | FRENC_PRED_SORTED },
+	{ FRENC_PRED_GLOB, "/lib/[ab]/*.py", FRENC_PRED_SORTED },
+	{ FRENC_PRED_GLOB, "/USR/*", FNM_CASEFOLD | FRENC_PRED_SORTED },
+	// the literal prefix stops at the extended pattern
+	{ FRENC_PRED_GLOB, "/usr/@(lib|bin)/*", FNM_EXTMATCH },
+	{ FRENC_PRED_GLOB, "/usr/@(lib|bin)/*",
+	  FNM_EXTMATCH | FRENC_PRED_SORTED },
+	{ FRENC_PRED_GLOB, "/usr/!(lib)/*", FNM_EXTMATCH | FRENC_PRED_SORTED },
+	{ FRENC_PRED_GLOB, "/+(usr|a)/*", FNM_EXTMATCH | FRENC_PRED_SORTED },
+	{ FRENC_PRED_FUNC, NULL, 0 },
+    };
+    static char *v[MAXSET];
+    for (int iter = 0; iter < 100; iter++) {
+	size_t n = genset(v, 1 + rnd(MAXSET));
+	void *enc;
+	size_t encsize = frenc(v, n, &enc);
+	assert(encsize < FRENC_ERROR);
+	for (size_t k = 0; k < sizeof preds / sizeof *preds; k++) {
+	    struct frenc_pred pred = {
+		.type = preds[k].type, .pat = preds[k].pat,
+		.flags = preds[k].flags, .func = has_digit7,
+	    };
+	    check_pred1(v, n, enc, encsize, &pred);
+	}
+	free(enc);
+	freeset(v, n);
+    }
+}
+
+int main(void)
+{
+    check_bloom();
+    check_cache();
+    check_trie();
+    check_delta();
+    check_pred();
+    return 0;
+}
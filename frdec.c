@@ -7,111 +7,94 @@
 #include <endian.h>
 #define FRENC_FORMAT
 #include "frenc.h"
+#include "diff.h"
 
-static const bool bigdiff[256] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
-    1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+// The suffix dictionary, parsed from the header (tail[0] is empty).
+struct sfxdict {
+    unsigned n;
+    const char *tail[256];
+    unsigned char len[256];
 };
 
-#define UNLIKELY(cond) __builtin_expect(cond, 0)
-
-#define CKBAD(cond)			\
-    do {				\
-	if (check && UNLIKELY(cond))	\
-	    return FRENC_ERR_DATA;	\
-    } while (0)
-
-#define APPLY_NEGATIVE_DIFF(diff)	\
-    do {				\
-	size_t absdiff = -diff;		\
-	CKBAD(absdiff > olen);		\
-	len = olen - absdiff;		\
-    } while (0)
+// Parse the suffix dictionary header.  Returns the header size,
+// or an error.
+static size_t getdict(const char *enc, const char *end,
+		      struct sfxdict *dict)
+{
+    const char *p = enc;
+    dict->n = (unsigned char) *p++;
+    dict->tail[0] = "";
+    dict->len[0] = 0;
+    for (unsigned i = 1; i <= dict->n; i++) {
+	if (p >= end)
+	    return FRENC_ERR_DATA;
+	size_t len = strlen(p);
+	if (len == 0 || len > 255)
+	    return FRENC_ERR_DATA;
+	dict->tail[i] = p;
+	dict->len[i] = len;
+	p += len + 1;
+    }
+    // the first entry must follow
+    if (p >= end)
+	return FRENC_ERR_DATA;
+    return p - enc;
+}
 
-#define APPLY_NONNEGATIVE_DIFF(diff)	\
-    do {				\
-	len = olen + diff;		\
-	CKBAD(len > INT_MAX);		\
+#define GETREF()				\
+    do {					\
+	if (dict) {				\
+	    CKBAD(end - enc < 2);		\
+	    ref = (unsigned char) *enc++;	\
+	    CKBAD(ref > dict->n);		\
+	}					\
     } while (0)
 
 static inline size_t decpass(const char *enc, const char *end,
 			     char **v, unsigned *ll, bool hasll,
 			     char *strtab, size_t *strtab_size,
-			     int pass, bool check)
+			     int pass, bool check, bool text, char delim,
+			     const struct sfxdict *dict)
 {
-    char **v0;
+    char **v0 = v;
     size_t n;
     char *ostrtab;
+    // in text mode, no v[] is built: the strings are rendered back to back
+    // into strtab, each string followed by the delim byte
+    char *text0 = strtab;
+    // with the suffix dictionary, each suffix is preceded by a reference
+    // to the tail which should be appended to the suffix
+    unsigned ref = 0;
+    GETREF();
     if (pass == 1) {
 	n = 1;
-	*strtab_size = strlen(enc) + 1;
-	enc += *strtab_size;
+	size_t len = strlen(enc);
+	*strtab_size = len + 1 + (dict ? dict->len[ref] : 0);
+	enc += len + 1;
     }
     else {
-	v0 = v;
-	*v++ = ostrtab = strtab;
-	strtab = stpcpy(strtab, enc) + 1;
-	enc += strtab - ostrtab;
+	ostrtab = strtab;
+	if (!text)
+	    *v++ = strtab;
+	size_t len = stpcpy(strtab, enc) - strtab;
+	enc += len + 1;
+	if (dict) {
+	    memcpy(strtab + len, dict->tail[ref], dict->len[ref]);
+	    len += dict->len[ref];
+	    strtab[len] = '\0';
+	}
+	strtab += len + 1;
 	if (hasll)
-	    *ll++ = strtab - ostrtab - 1;
+	    *ll++ = len;
+	if (text)
+	    strtab[-1] = delim;
     }
     size_t olen = 0;
     while (enc < end) {
-	int diff = *enc++;
-	size_t len;
-	if (UNLIKELY(bigdiff[(unsigned char) diff])) {
-	    int left = end - enc;
-	    if (diff == 127) {
-		CKBAD(left < 2);
-		diff += (unsigned char) *enc++;
-		APPLY_NONNEGATIVE_DIFF(diff);
-	    }
-	    else if (diff == -127) {
-		CKBAD(left < 2);
-		diff -= (unsigned char) *enc++;
-		APPLY_NEGATIVE_DIFF(diff);
-	    }
-	    else {
-		assert(diff == -128);
-		CKBAD(left < 3);
-		union { short s16; unsigned short u16; } u;
-		memcpy(&u, enc, 2);
-		enc += 2;
-		u.u16 = le16toh(u.u16);
-		if (u.s16 >= 0) {
-		    diff = u.s16 + (DIFF2_HI+1);
-		    APPLY_NONNEGATIVE_DIFF(diff);
-		}
-		else {
-		    diff = u.s16 + (DIFF2_LO-1);
-		    if (diff < DIFF3_LO)
-			len = 0;
-		    else
-			APPLY_NEGATIVE_DIFF(diff);
-		}
-	    }
-	}
-	else {
-	    CKBAD(enc == end);
-	    if (diff < 0)
-		APPLY_NEGATIVE_DIFF(diff);
-	    else
-		APPLY_NONNEGATIVE_DIFF(diff);
-	}
+	size_t len = getlen(&enc, end, olen, check);
+	if (check && UNLIKELY(len >= FRENC_ERROR))
+	    return len;
+	GETREF();
 	olen = len;
 	if (pass == 1)
 	    n++;
@@ -119,7 +102,10 @@ static inline size_t decpass(const char *enc, const char *end,
 	if (pass == 1)
 	    *strtab_size += len;
 	else {
-	    *v++ = memcpy(strtab, ostrtab, len);
+	    if (text)
+		memcpy(strtab, ostrtab, len);
+	    else
+		*v++ = memcpy(strtab, ostrtab, len);
 	    ostrtab = strtab;
 	    strtab += len;
 	    if (hasll)
@@ -128,34 +114,53 @@ static inline size_t decpass(const char *enc, const char *end,
 	// suffix
 	if (pass == 1) {
 	    len = strlen(enc);
-	    *strtab_size += len + 1;
+	    *strtab_size += len + 1 + (dict ? dict->len[ref] : 0);
 	}
 	else {
 	    len = stpcpy(strtab, enc) - strtab;
-	    strtab += len + 1;
+	    size_t tlen = 0;
+	    if (dict) {
+		tlen = dict->len[ref];
+		memcpy(strtab + len, dict->tail[ref], tlen);
+		strtab[len+tlen] = '\0';
+	    }
+	    strtab += len + tlen + 1;
 	    if (hasll)
-		*ll++ += len;
+		*ll++ += len + tlen;
+	    if (text)
+		strtab[-1] = delim;
 	}
 	enc += len + 1;
     }
     if (pass == 1)
 	return n;
+    if (text)
+	return strtab - text0;
     *v = NULL;
     return v - v0;
 }
 
 static inline size_t frdecll(const void *enc, size_t encsize, char ***vp,
-			     unsigned **llp, bool hasllp)
+			     unsigned **llp, bool hasllp, bool sfx)
 {
     assert(encsize > 0);
     assert(enc);
     assert(vp);
-    const char *end = (char *) enc + encsize;
+    const char *p = enc;
+    const char *end = p + encsize;
     if (end[-1] != '\0')
 	return FRENC_ERR_DATA;
+    struct sfxdict dict;
+    if (sfx) {
+	size_t hsize = getdict(p, end, &dict);
+	if (hsize >= FRENC_ERROR)
+	    return hsize;
+	p += hsize;
+    }
     // first pass, compute n and the total size
     size_t strtab_size;
-    size_t n = decpass(enc, end, NULL, NULL, 0, NULL, &strtab_size, 1, 1);
+    size_t n = decpass(p, end, NULL, NULL, 0, NULL, &strtab_size,
+		       1, 1, 0, 0, sfx ? &dict : NULL);
     if (n >= FRENC_ERROR)
 	return n;
     size_t malloc_size = (n + 1) * sizeof(char *) + strtab_size +
@@ -166,7 +171,8 @@ static inline size_t frdecll(const void *enc, size_t encsize, char ***vp,
     unsigned *ll =  hasllp ? (void *) (v + n + 1) : NULL;
     char *strtab = !hasllp ? (char *) (v + n + 1) : (char *) (ll + n);
     // second pass, build the output
-    decpass(enc, end, v, ll, hasllp, strtab, &strtab_size, 2, 0);
+    decpass(p, end, v, ll, hasllp, strtab, &strtab_size,
+	    2, 0, 0, 0, sfx ? &dict : NULL);
     *vp = v;
     if (hasllp)
 	*llp = ll;
@@ -175,10 +181,62 @@ static inline size_t frdecll(const void *enc, size_t encsize, char ***vp,
 
 size_t frdec(const void *enc, size_t encsize, char ***vp)
 {
-    return frdecll(enc, encsize, vp, NULL, 0);
+    return frdecll(enc, encsize, vp, NULL, 0, 0);
 }
 
 size_t frdecl(const void *enc, size_t encsize, char ***vp, unsigned **llp)
 {
-    return frdecll(enc, encsize, vp, llp, 1);
+    return frdecll(enc, encsize, vp, llp, 1, 0);
+}
+
+size_t frdec_sfx(const void *enc, size_t encsize, char ***vp)
+{
+    return frdecll(enc, encsize, vp, NULL, 0, 1);
+}
+
+size_t frdecl_sfx(const void *enc, size_t encsize, char ***vp,
+		  unsigned **llp)
+{
+    return frdecll(enc, encsize, vp, llp, 1, 1);
+}
+
+static inline size_t frdec_textd(const void *enc, size_t encsize,
+				 char delim, char *buf, bool sfx)
+{
+    assert(encsize > 0);
+    assert(enc);
+    const char *p = enc;
+    const char *end = p + encsize;
+    if (end[-1] != '\0')
+	return FRENC_ERR_DATA;
+    struct sfxdict dict;
+    if (sfx) {
+	size_t hsize = getdict(p, end, &dict);
+	if (hsize >= FRENC_ERROR)
+	    return hsize;
+	p += hsize;
+    }
+    // The text takes exactly as much space as the strings with their
+    // terminating null bytes, so the first pass computes the size.
+    if (buf == NULL) {
+	size_t text_size;
+	size_t n = decpass(p, end, NULL, NULL, 0, NULL, &text_size,
+			   1, 1, 0, 0, sfx ? &dict : NULL);
+	if (n >= FRENC_ERROR)
+	    return n;
+	return text_size;
+    }
+    // The data has been validated by the first pass.
+    return decpass(p, end, NULL, NULL, 0, buf, NULL,
+		   2, 0, 1, delim, sfx ? &dict : NULL);
+}
+
+size_t frdec_text(const void *enc, size_t encsize, char delim, char *buf)
+{
+    return frdec_textd(enc, encsize, delim, buf, 0);
+}
+
+size_t frdec_sfx_text(const void *enc, size_t encsize, char delim, char *buf)
+{
+    return frdec_textd(enc, encsize, delim, buf, 1);
 }
@@ -0,0 +1,280 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <endian.h>
+#define FRENC_FORMAT
+#include "frenc.h"
+#include "diff.h"
+
+// The delta is made of two front-coded streams: the strings deleted
+// from the base, and the strings inserted into the base.
+//
+//	delsize del ins
+//
+// where delsize is a 32-bit little-endian size of the del stream.
+// Either stream can be empty (the ins stream takes the rest of data).
+
+// Compare two strings with known lengths, byte-wise, like strcmp.
+static inline int cmp(const char *s1, size_t len1,
+		      const char *s2, size_t len2)
+{
+    int c = memcmp(s1, s2, len1 < len2 ? len1 : len2);
+    if (c)
+	return c;
+    return (len1 > len2) - (len1 < len2);
+}
+
+size_t frenc_delta(const void *base, size_t basesize,
+		   char **v, size_t n, void **encp)
+{
+    assert(v);
+    assert(encp);
+    char **bv;
+    unsigned *bl;
+    size_t bn = frdecl(base, basesize, &bv, &bl);
+    if (bn >= FRENC_ERROR)
+	return bn;
+    // the deletions and insertions, as pointers into bv[] and v[]
+    char **dv = malloc((bn + n + 2) * sizeof *dv);
+    if (dv == NULL) {
+	free(bv);
+	return FRENC_ERR_MALLOC;
+    }
+    size_t dn = 0, in = 0;
+    char **iv = dv + bn + 1;
+    size_t i = 0, j = 0;
+    size_t len = n ? strlen(v[0]) : 0;
+    while (i < bn || j < n) {
+	int c;
+	if (i == bn)
+	    c = 1;
+	else if (j == n)
+	    c = -1;
+	else
+	    c = cmp(bv[i], bl[i], v[j], len);
+	if (c <= 0) {
+	    // the base must be sorted, too
+	    if (i + 1 < bn && cmp(bv[i], bl[i], bv[i+1], bl[i+1]) > 0)
+		goto unsorted;
+	    if (c < 0)
+		dv[dn++] = bv[i];
+	    i++;
+	}
+	if (c >= 0) {
+	    if (c > 0)
+		iv[in++] = v[j];
+	    if (++j < n) {
+		size_t olen = len;
+		len = strlen(v[j]);
+		if (cmp(v[j-1], olen, v[j], len) > 0)
+		    goto unsorted;
+	    }
+	}
+    }
+    void *del = NULL, *ins = NULL;
+    size_t delsize = 0, inssize = 0;
+    if (dn)
+	delsize = frenc(dv, dn, &del);
+    if (delsize < FRENC_ERROR && in)
+	inssize = frenc(iv, in, &ins);
+    free(dv);
+    free(bv);
+    size_t total = FRENC_ERR_RANGE;
+    if (delsize >= FRENC_ERROR)
+	total = delsize;
+    else if (inssize >= FRENC_ERROR)
+	total = inssize;
+    else if (delsize <= UINT32_MAX) {
+	total = 4 + delsize + inssize;
+	char *enc = malloc(total);
+	if (enc == NULL)
+	    total = FRENC_ERR_MALLOC;
+	else {
+	    uint32_t size32 = htole32(delsize);
+	    memcpy(enc, &size32, 4);
+	    if (delsize)
+		memcpy(enc + 4, del, delsize);
+	    if (inssize)
+		memcpy(enc + 4 + delsize, ins, inssize);
+	    *encp = enc;
+	}
+    }
+    free(del);
+    free(ins);
+    return total;
+unsorted:
+    free(dv);
+    free(bv);
+    return FRENC_ERR_DATA;
+}
+
+// The cursor walks a front-coded stream, one string at a time.
+// The current string is kept in the buffer s[]: only its suffix
+// is copied, the prefix is left in place from the previous string.
+struct cursor {
+    const char *p, *end;
+    char *s;
+    size_t len;
+    size_t olen;
+    size_t alloc;
+    bool first;
+    bool eof;
+};
+
+// Start the walk over the stream, which can be empty.  The buffer
+// is kept, so that the second pass over the same stream does not
+// need to grow it.
+static void start(struct cursor *c, const char *enc, size_t encsize)
+{
+    c->p = enc;
+    c->end = enc + encsize;
+    c->len = c->olen = 0;
+    c->first = 1;
+    c->eof = encsize == 0;
+}
+
+// Advance to the next string (to the first one, after start).
+// Returns 0, or an error (only if check is true, which is also
+// the only case in which the buffer is grown).
+static size_t next(struct cursor *c, bool check)
+{
+    if (c->p == c->end) {
+	c->eof = 1;
+	return 0;
+    }
+    size_t len = 0;
+    if (!c->first) {
+	len = getlen(&c->p, c->end, c->olen, check);
+	if (check && UNLIKELY(len >= FRENC_ERROR))
+	    return len;
+	// the prefix is taken from the previous string
+	CKBAD(len > c->len);
+	c->olen = len;
+    }
+    c->first = 0;
+    size_t slen = strlen(c->p);
+    if (check && len + slen >= c->alloc) {
+	size_t alloc = 2 * c->alloc > len + slen + 1 ?
+		       2 * c->alloc : len + slen + 1;
+	char *s = realloc(c->s, alloc);
+	if (s == NULL)
+	    return FRENC_ERR_MALLOC;
+	c->s = s;
+	c->alloc = alloc;
+    }
+    memcpy(c->s + len, c->p, slen + 1);
+    c->p += slen + 1;
+    c->len = len + slen;
+    return 0;
+}
+
+#define NEXT(c)					\
+    do {					\
+	size_t rc = next(c, check);		\
+	if (check && UNLIKELY(rc >= FRENC_ERROR)) \
+	    return rc;				\
+    } while (0)
+
+// Merge the base with the insertions, skipping the deletions.
+// On the first pass, the data is validated, and the number of strings
+// and the total size of the strings are computed; on the second pass,
+// the strings are written into v[] and strtab.
+static inline size_t mergepass(struct cursor *b, struct cursor *d,
+			       struct cursor *a, char **v, unsigned *ll,
+			       char *strtab, size_t *strtab_size,
+			       int pass, bool check)
+{
+    size_t n = 0;
+    NEXT(b);
+    NEXT(d);
+    NEXT(a);
+    while (!b->eof || !a->eof) {
+	if (!d->eof) {
+	    // the deletions must be in the base
+	    CKBAD(b->eof);
+	    int c = cmp(b->s, b->len, d->s, d->len);
+	    CKBAD(c > 0);
+	    if (c == 0) {
+		NEXT(b);
+		NEXT(d);
+		continue;
+	    }
+	}
+	struct cursor *c = b;
+	if (b->eof || (!a->eof && cmp(a->s, a->len, b->s, b->len) < 0))
+	    c = a;
+	if (pass == 1)
+	    *strtab_size += c->len + 1;
+	else {
+	    v[n] = memcpy(strtab, c->s, c->len + 1);
+	    ll[n] = c->len;
+	    strtab += c->len + 1;
+	}
+	n++;
+	NEXT(c);
+    }
+    CKBAD(!d->eof);
+    return n;
+}
+
+size_t frdec_delta(const void *base, size_t basesize,
+		   const void *enc, size_t encsize,
+		   char ***vp, unsigned **llp)
+{
+    assert(basesize > 0);
+    assert(base);
+    assert(enc);
+    assert(vp);
+    if (encsize < 4)
+	return FRENC_ERR_DATA;
+    uint32_t delsize;
+    memcpy(&delsize, enc, 4);
+    delsize = le32toh(delsize);
+    if (delsize > encsize - 4)
+	return FRENC_ERR_DATA;
+    const char *del = (const char *) enc + 4;
+    const char *ins = del + delsize;
+    size_t inssize = encsize - 4 - delsize;
+    // each stream must end with a null byte, so that strlen stops there
+    if (((const char *) base)[basesize-1] != '\0' ||
+	    (delsize && del[delsize-1] != '\0') ||
+	    (inssize && ins[inssize-1] != '\0'))
+	return FRENC_ERR_DATA;
+    struct cursor b = { .s = NULL, .alloc = 0 };
+    struct cursor d = b, a = b;
+    // first pass, compute n and the total size
+    size_t strtab_size = 0;
+    start(&b, base, basesize);
+    start(&d, del, delsize);
+    start(&a, ins, inssize);
+    size_t n = mergepass(&b, &d, &a, NULL, NULL, NULL, &strtab_size, 1, 1);
+    if (n >= FRENC_ERROR)
+	goto out;
+    char **v = malloc((n + 1) * sizeof *v + n * sizeof(unsigned) +
+		      strtab_size);
+    if (v == NULL) {
+	n = FRENC_ERR_MALLOC;
+	goto out;
+    }
+    unsigned *ll = (unsigned *) (v + n + 1);
+    char *strtab = (char *) (ll + n);
+    // second pass, build the output (the set can be empty,
+    // and then v[0] is NULL)
+    start(&b, base, basesize);
+    start(&d, del, delsize);
+    start(&a, ins, inssize);
+    mergepass(&b, &d, &a, v, ll, strtab, NULL, 2, 0);
+    v[n] = NULL;
+    *vp = v;
+    if (llp)
+	*llp = ll;
+out:
+    free(b.s);
+    free(d.s);
+    free(a.s);
+    return n;
+}
@@ -7,13 +7,27 @@
 #include "frenc.h"
 #include "lcp.h"
 
+// Copy the suffix s without its dictionary tail of tlen bytes.
+static inline char *puthead(char *enc, const char *s, size_t tlen)
+{
+    size_t len = strlen(s) - tlen;
+    memcpy(enc, s, len);
+    enc[len] = '\0';
+    return enc + len + 1;
+}
+
 // It is hard to estimate the encoded size from n only.  Therefore,
 // the encoding is done in two passes: on the first pass, the encoded
 // size is calculated, and on the second, the actual encoding is done.
 // Also, lcp values obtained on the first pass are stored in pplen[]
 // and reused on the second ("pp" stands for preprocessing).
+// In the suffix dictionary mode, refs[] tell which dictionary tail
+// each string ends with, and the tails of tlen[ref] bytes are cut off
+// the suffixes (in the plain mode, refs is NULL).
 static inline size_t encpass(char **v, size_t n, char *enc,
-			     int pass, int *pplen)
+			     int pass, int *pplen,
+			     const unsigned char *refs,
+			     const unsigned char *tlen)
 {
     // len1 and len2 are only used in the first pass to calculate
     // common prefix lengths, which are stored in pplen[]; in the
@@ -21,6 +35,10 @@ static inline size_t encpass(char **v, size_t n, char *enc,
     size_t len1;
     if (pass == 1)
 	len1 = strlen(v[0]);
+    else if (refs) {
+	*enc++ = refs[0];
+	enc = puthead(enc, v[0], tlen[refs[0]]);
+    }
     else
 	enc = stpcpy(enc, v[0]) + 1;
     // total encoded size is only calculated in the first pass
@@ -99,7 +117,11 @@ static inline size_t encpass(char **v, size_t n, char *enc,
 		enc += 2;
 	    }
 	}
-	if (pass == 2)
+	if (pass == 2 && refs) {
+	    *enc++ = refs[i];
+	    enc = puthead(enc, v[i] + len, tlen[refs[i]]);
+	}
+	else if (pass == 2)
 	    enc = stpcpy(enc, v[i] + len) + 1;
 	else {
 	    total += len2 - len + 1;
@@ -119,7 +141,7 @@ size_t frenc(char **v, size_t n, void **encp)
     if (pplen == NULL)
 	return FRENC_ERR_MALLOC;
     // first pass
-    size_t total = encpass(v, n, NULL, 1, pplen);
+    size_t total = encpass(v, n, NULL, 1, pplen, NULL, NULL);
     if (total >= FRENC_ERROR) {
 	free(pplen);
 	return total;
@@ -130,8 +152,177 @@ size_t frenc(char **v, size_t n, void **encp)
 	free(pplen);
 	return FRENC_ERR_MALLOC;
     }
-    encpass(v, n, enc, 2, pplen);
+    encpass(v, n, enc, 2, pplen, NULL, NULL);
     free(pplen);
     *encp = enc;
     return total;
 }
+
+// Suffix dictionary tails are picked among the tails of the suffixes
+// which start at a '.' or '/' byte, such as ".so.1" or "/__init__.py".
+// Only the last few such positions within TAIL_MAX bytes are considered.
+#define TAIL_MIN 2
+#define TAIL_MAX 32
+#define TAIL_CAND 4
+
+// Candidate tails are counted in an open-addressing hash table, sized
+// after the number of candidates, up to TAIL_SLOTS; when it gets 3/4
+// full, new candidates are ignored (frequent tails are likely to have
+// been seen by then).
+#define TAIL_SLOTS (1 << 16)
+
+struct tailent {
+    const char *s;
+    unsigned len;
+    unsigned cnt;
+    // the dictionary reference, 0 if the tail has not been selected
+    unsigned ref;
+};
+
+static struct tailent *tailget(struct tailent *tab, size_t slots,
+			       size_t *used, const char *s, unsigned len)
+{
+    unsigned h = 2166136261;
+    for (unsigned i = 0; i < len; i++)
+	h = (h ^ (unsigned char) s[i]) * 16777619;
+    for (h &= slots - 1; tab[h].s; h = (h + 1) & (slots - 1))
+	if (tab[h].len == len && memcmp(tab[h].s, s, len) == 0)
+	    return &tab[h];
+    if (used == NULL || *used >= slots / 4 * 3)
+	return NULL;
+    ++*used;
+    tab[h].s = s;
+    tab[h].len = len;
+    return &tab[h];
+}
+
+// Find the candidate tails of the suffix s of length len,
+// longest first; returns the number of candidates.
+static inline int tailcand(const char *s, size_t len, unsigned *tl)
+{
+    int k = 0;
+    if (len < TAIL_MIN)
+	return 0;
+    size_t lo = len > TAIL_MAX ? len - TAIL_MAX : 0;
+    for (size_t j = len - TAIL_MIN + 1; j-- > lo && k < TAIL_CAND; )
+	if (s[j] == '.' || s[j] == '/')
+	    tl[k++] = len - j;
+    // reverse, to get the longest first
+    for (int i = 0; i < k / 2; i++) {
+	unsigned t = tl[i];
+	tl[i] = tl[k-1-i];
+	tl[k-1-i] = t;
+    }
+    return k;
+}
+
+static int tailcmp(const void *p1, const void *p2)
+{
+    const struct tailent *t1 = *(const struct tailent **) p1;
+    const struct tailent *t2 = *(const struct tailent **) p2;
+    // each use of a tail saves len bytes
+    size_t score1 = (size_t) t1->cnt * t1->len;
+    size_t score2 = (size_t) t2->cnt * t2->len;
+    if (score1 != score2)
+	return score1 > score2 ? -1 : 1;
+    if (t1->len != t2->len)
+	return t1->len < t2->len ? -1 : 1;
+    return memcmp(t1->s, t2->s, t1->len);
+}
+
+size_t frenc_sfx(char **v, size_t n, void **encp)
+{
+    assert(n > 0);
+    assert(v);
+    assert(encp);
+    int *pplen = malloc(n * sizeof(int));
+    if (pplen == NULL)
+	return FRENC_ERR_MALLOC;
+    // the first pass also gives the lcp values, and thus the suffixes
+    size_t total = encpass(v, n, NULL, 1, pplen, NULL, NULL);
+    if (total >= FRENC_ERROR) {
+	free(pplen);
+	return total;
+    }
+    pplen[0] = 0;
+    // at most TAIL_CAND candidates per string, at most half full
+    size_t slots = 16;
+    while (slots < TAIL_SLOTS && slots / 2 < n * TAIL_CAND)
+	slots *= 2;
+    unsigned char *refs = malloc(n);
+    struct tailent *tab = calloc(slots, sizeof *tab);
+    struct tailent **sorted = malloc(slots * sizeof *sorted);
+    if (refs == NULL || tab == NULL || sorted == NULL) {
+	total = FRENC_ERR_MALLOC;
+	goto out;
+    }
+    // count the candidate tails
+    size_t used = 0;
+    for (size_t i = 0; i < n; i++) {
+	const char *suf = v[i] + pplen[i];
+	size_t len = strlen(suf);
+	unsigned tl[TAIL_CAND];
+	int k = tailcand(suf, len, tl);
+	for (int j = 0; j < k; j++) {
+	    struct tailent *t = tailget(tab, slots, &used,
+					suf + len - tl[j], tl[j]);
+	    if (t)
+		t->cnt++;
+	}
+    }
+    // select up to 255 most profitable tails
+    size_t m = 0;
+    for (size_t h = 0; h < slots; h++)
+	if (tab[h].cnt > 1)
+	    sorted[m++] = &tab[h];
+    qsort(sorted, m, sizeof *sorted, tailcmp);
+    if (m > 255)
+	m = 255;
+    unsigned char tlen[256] = { 0 };
+    total += 1;
+    for (size_t j = 0; j < m; j++) {
+	sorted[j]->ref = j + 1;
+	tlen[j+1] = sorted[j]->len;
+	total += sorted[j]->len + 1;
+    }
+    // assign the longest selected tail to each string
+    for (size_t i = 0; i < n; i++) {
+	const char *suf = v[i] + pplen[i];
+	size_t len = strlen(suf);
+	unsigned tl[TAIL_CAND];
+	int k = tailcand(suf, len, tl);
+	refs[i] = 0;
+	for (int j = 0; j < k; j++) {
+	    struct tailent *t = tailget(tab, slots, NULL,
+					suf + len - tl[j], tl[j]);
+	    if (t && t->ref) {
+		refs[i] = t->ref;
+		break;
+	    }
+	}
+	// one byte for the reference, minus the tail
+	total += 1;
+	total -= tlen[refs[i]];
+    }
+    // build the output
+    char *enc = malloc(total);
+    if (enc == NULL) {
+	total = FRENC_ERR_MALLOC;
+	goto out;
+    }
+    char *p = enc;
+    *p++ = m;
+    for (size_t j = 0; j < m; j++) {
+	memcpy(p, sorted[j]->s, sorted[j]->len);
+	p += sorted[j]->len;
+	*p++ = '\0';
+    }
+    encpass(v, n, p, 2, pplen, refs, tlen);
+    *encp = enc;
+out:
+    free(pplen);
+    free(refs);
+    free(tab);
+    free(sorted);
+    return total;
+}
@@ -32,6 +32,181 @@ size_t frdec(const void *enc, size_t encsize, char ***vp);
 // return as v[]; the caller should free v[] and must not free ll[].
 size_t frdecl(const void *enc, size_t encsize, char ***vp, unsigned **llp);
 
+// Decode straight into the text form, in which each string is followed
+// by the delim byte (normally '\n', or '\0' akin to "sort -z").  No v[]
+// is built, and the text can be written out in a few big chunks.
+// The function should be called twice: with buf=NULL, it validates
+// the data and returns the size of the text (which is the same as
+// the size of the strings with their terminating null bytes); then
+// it must be called with the buffer of at least that size, to render
+// the text into the buffer.  Returns the size of the text, or an error.
+size_t frdec_text(const void *enc, size_t encsize, char delim, char *buf);
+
+// Encode the strings v[] as a delta against the base, which is another
+// encoded set of strings (typically, the previous version of the set).
+// Both sets must be sorted byte-wise.  The delta only stores the strings
+// deleted from and inserted into the base, as front-coded runs, and can
+// be empty (v[] is then the same as the base, and n can be 0).
+// Returns the delta size, or an error (FRENC_ERR_DATA also means that
+// either set is not sorted).  Upon success, the delta is
+// returned via the encp pointer, which the caller should free after use.
+size_t frenc_delta(const void *base, size_t basesize,
+		   char **v, size_t n, void **encp);
+
+// Decode the delta by merging it with the same base, which is walked
+// in place (not decoded as a whole).  The strings are returned as with
+// frdecl (llp can be NULL).  Returns the number of strings, which can
+// be 0 (v[0] is then NULL), or an error.
+size_t frdec_delta(const void *base, size_t basesize,
+		   const void *enc, size_t encsize,
+		   char ***vp, unsigned **llp);
+
+// Decode only the strings which match the predicate.  The predicate
+// is evaluated while walking the encoded data, and since the first len
+// bytes of each string are the same as in the previous string, prefix
+// matching mostly needs no string comparisons.  Only the matching
+// strings are put into the output, which is returned as with frdecl
+// (llp can be NULL).  Returns the number of matching strings, which
+// can be 0 (v[0] is then NULL), or an error.
+struct frenc_pred {
+    // FRENC_PRED_PREFIX: the strings which start with pat;
+    // FRENC_PRED_SUFFIX: the strings which end with pat;
+    // FRENC_PRED_GLOB: the strings which match the fnmatch(3) pattern;
+    // FRENC_PRED_FUNC: the strings for which func returns non-zero.
+    int type;
+    const char *pat;
+    // fnmatch(3) flags for the glob pattern, and FRENC_PRED_SORTED,
+    // which tells that the strings are sorted byte-wise, so that the
+    // walk can stop past the last string with the prefix (or with
+    // the literal prefix of the glob pattern)
+    int flags;
+    // the callback also gets the length of the common prefix with
+    // the previous string, to avoid re-testing the same bytes
+    int (*func)(const char *s, size_t slen, size_t len, void *arg);
+    void *arg;
+};
+#define FRENC_PRED_PREFIX 1
+#define FRENC_PRED_SUFFIX 2
+#define FRENC_PRED_GLOB   3
+#define FRENC_PRED_FUNC   4
+#define FRENC_PRED_SORTED (1 << 30)
+size_t frdec_filter(const void *enc, size_t encsize,
+		    const struct frenc_pred *pred,
+		    char ***vp, unsigned **llp);
+
+// The suffix dictionary mode.  Front compression only exploits common
+// prefixes, while in file lists, the remaining suffixes often end with
+// the same tails, such as ".so.1" or "/__init__.py".  In this mode,
+// the encoder selects up to 255 frequent tails and puts them into the
+// dictionary at the beginning of the compressed data, and each suffix
+// then refers to its tail in the dictionary.  The data encoded with
+// frenc_sfx must be decoded with the corresponding *_sfx functions,
+// which work just like their plain counterparts.  NB: the data carries
+// no marker of the mode, so the caller must keep track of it; the plain
+// decoders do not detect the suffix dictionary data, and return garbage
+// rather than FRENC_ERR_DATA (and vice versa).
+size_t frenc_sfx(char **v, size_t n, void **encp);
+size_t frdec_sfx(const void *enc, size_t encsize, char ***vp);
+size_t frdecl_sfx(const void *enc, size_t encsize, char ***vp,
+		  unsigned **llp);
+size_t frdec_sfx_text(const void *enc, size_t encsize, char delim, char *buf);
+
+// Build the membership (Bloom) filter for the strings v[] (the same input as
+// passed to frenc).  The filter should be stored alongside the encoded
+// data; it takes about 2 bytes per string.  Returns the filter size,
+// or an error.  The filter is returned via the filtp pointer, which
+// the caller should free after use.
+size_t frenc_bloom(char **v, size_t n, void **filtp);
+
+// Test whether the string s of length len can be among the strings
+// the filter was built for.  Returns 0 if it definitely is not, and
+// 1 if it may be, in which case the caller should do the real lookup
+// (false positives happen at the rate of about 0.1%).  A definite no
+// costs one or two cache misses.
+int frbloom_maybe_contains(const void *filt, size_t filtsize,
+			   const char *s, size_t len);
+
+// The cache of decoded data, for read-heavy services which look up
+// the same blobs from many threads.  The blobs are decoded with frdecl
+// once and then served to all threads, until evicted (with the CLOCK
+// algorithm) to keep the total size of the decoded data within the
+// budget of bytes.  The cache is keyed by the blob's address and size,
+// so the blob must not change while it can be found in the cache:
+// before a blob is freed or modified, it must be removed from the cache
+// with frenc_cache_remove (otherwise, another blob of the same size
+// placed at the same address would get the stale decoded strings).
+// The strings of a removed blob which are currently held by callers
+// stay valid until released.
+struct frenc_cache;
+struct frenc_cache *frenc_cache_new(size_t budget);
+void frenc_cache_free(struct frenc_cache *cache);
+void frenc_cache_remove(struct frenc_cache *cache,
+			const void *enc, size_t encsize);
+
+// Get the decoded strings, as with frdecl (llp can be NULL).  Returns
+// the number of strings, or an error.  Upon success, the ref pointer is
+// returned via refp; v[] and ll[] stay valid until the caller releases
+// them with frenc_cache_put(ref).
+size_t frenc_cache_get(struct frenc_cache *cache,
+		       const void *enc, size_t encsize,
+		       char ***vp, unsigned **llp, void **refp);
+void frenc_cache_put(void *ref);
+
+// The number of lookups served from the cache (hits) and decoded
+// (misses), and the size of the decoded data currently in the cache.
+// Any of the pointers can be NULL.
+void frenc_cache_stats(struct frenc_cache *cache,
+		       size_t *hits, size_t *misses, size_t *bytes);
+
+// The radix (patricia) trie of the decoded strings, which must be
+// sorted byte-wise, e.g. with LC_ALL=C sort(1).  The trie is built
+// from the common prefix lengths already present in the encoded data,
+// while the strings are being decoded.  Only the bytes right past
+// a common prefix are compared, to verify the order and to extend
+// the prefixes which were truncated on encoding.  The nodes are placed
+// in a single array in post-order, so that the root is the last node.
+// The children of a node are kid[kid0..kid0+nkid), and the first bytes
+// of their edges are kidc[kid0..kid0+nkid), in ascending order.
+// The strings in the subtree of a node make up the range v[lo..hi),
+// which is how the subtree is enumerated.
+#define FRTRIE_NONE (~0u)
+struct frtrie_node {
+    // the length of the common prefix of the strings in the subtree
+    unsigned depth;
+    // the strings v[lo..hi) are in the subtree; the node itself
+    // stands for a string if ll[lo] == depth
+    unsigned lo, hi;
+    // the children
+    unsigned kid0, nkid;
+};
+struct frtrie {
+    // the decoded strings, as returned by frdecl
+    size_t n;
+    char **v;
+    unsigned *ll;
+    size_t nnodes;
+    unsigned *kid;
+    unsigned char *kidc;
+    struct frtrie_node nodes[];
+};
+
+// Decode the data and build the trie.  Returns the number of strings,
+// or an error (FRENC_ERR_DATA also means that the strings are not
+// sorted).  Upon success, the trie is returned via the tp pointer;
+// the caller should free it with frtrie_free after use.
+size_t frdec_trie(const void *enc, size_t encsize, struct frtrie **tp);
+void frtrie_free(struct frtrie *t);
+
+// Find the string s of length len.  Returns its index in v[],
+// or t->n if there is no such string.
+size_t frtrie_find(const struct frtrie *t, const char *s, size_t len);
+
+// Find the strings which start with the prefix s of length len.
+// Returns lo, and hi via the hip pointer, so that the strings
+// are v[lo..hi); lo == hi if there are no such strings.
+size_t frtrie_prefix(const struct frtrie *t, const char *s, size_t len,
+		     size_t *hip);
+
 // The most obvious reason for an error is a malloc failure.
 #define FRENC_ERR_MALLOC (~(size_t)0-0)
 // There are also certain size limits: each string in v[] must be
@@ -116,6 +291,20 @@ size_t frdecio(FILE *in, FILE *out, bool z);
 // The special value -32768 bears just this meaning: it resets the
 // length of the common prefix to 0.
 
+// In the suffix dictionary mode, the data starts with the dictionary
+//
+//	ndict tail1 '\0' ... tailN '\0'
+//
+// where the byte ndict is the number of tails (up to 255), and each
+// tail is a non-empty string shorter than 256 bytes.  The entries then
+// take the form
+//
+//	ref str '\0'
+//	b1 [ b2 | b2 b3 ] ref suf '\0'
+//
+// where the byte ref refers to the tail to be appended to the suffix,
+// 1 through ndict; ref=0 means that there is no tail.
+
 #endif
 
 #endif
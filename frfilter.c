@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <endian.h>
+#include <fnmatch.h>
+#define FRENC_FORMAT
+#include "frenc.h"
+#include "diff.h"
+
+// The filter walks the encoded data, restoring each string in place
+// over the previous one, so only the suffixes are copied.  The prefix
+// predicates (and the literal prefix of a glob pattern) keep track of
+// how many leading bytes of the current string match the pattern;
+// since the first len bytes are the same as in the previous string,
+// the result often follows without looking at the string at all.
+
+struct prefix {
+    const char *pat;
+    size_t len;
+    // the number of leading bytes of the current string which match
+    size_t pm;
+};
+
+// Returns 1 if the string matches the prefix, 0 if it does not,
+// and -1 if no further strings can match (only if sorted).
+static inline int prefix_match(struct prefix *pf, const char *s,
+			       size_t slen, size_t len, bool sorted)
+{
+    size_t pm = pf->pm;
+    if (len >= pm) {
+	// the byte at pm is the same as in the previous string
+	if (pm == pf->len)
+	    return 1;
+	if (len > pm)
+	    return 0;
+    }
+    else
+	pm = len;
+    while (pm < pf->len && pm < slen && s[pm] == pf->pat[pm])
+	pm++;
+    pf->pm = pm;
+    if (pm == pf->len)
+	return 1;
+    if (sorted && pm < slen &&
+	    (unsigned char) s[pm] > (unsigned char) pf->pat[pm])
+	return -1;
+    return 0;
+}
+
+// The length of the glob pattern up to the first special character.
+// With FNM_EXTMATCH, the patterns such as @(a|b) and !(a) start with
+// a special character, too.
+static size_t literal(const char *pat, int flags)
+{
+#ifdef FNM_EXTMATCH
+    if (flags & FNM_EXTMATCH)
+	return strcspn(pat, "*?[\\+@!");
+#endif
+    (void) flags;
+    return strcspn(pat, "*?[\\");
+}
+
+struct strbuf {
+    char *s;
+    size_t len;
+    size_t alloc;
+};
+
+static inline bool reserve(struct strbuf *sb, size_t len)
+{
+    if (sb->len + len <= sb->alloc)
+	return 1;
+    size_t alloc = sb->alloc ? 2 * sb->alloc : 4096;
+    while (alloc < sb->len + len)
+	alloc *= 2;
+    char *s = realloc(sb->s, alloc);
+    if (s == NULL)
+	return 0;
+    sb->s = s;
+    sb->alloc = alloc;
+    return 1;
+}
+
+size_t frdec_filter(const void *enc, size_t encsize,
+		    const struct frenc_pred *pred,
+		    char ***vp, unsigned **llp)
+{
+    assert(encsize > 0);
+    assert(enc);
+    assert(pred);
+    assert(vp);
+    const char *p = enc;
+    const char *end = p + encsize;
+    if (end[-1] != '\0')
+	return FRENC_ERR_DATA;
+    struct prefix pf = { .pm = 0 };
+    size_t sfxlen = 0;
+    switch (pred->type) {
+    case FRENC_PRED_PREFIX:
+	pf.pat = pred->pat;
+	pf.len = strlen(pred->pat);
+	break;
+    case FRENC_PRED_GLOB:
+	pf.pat = pred->pat;
+#ifdef FNM_CASEFOLD
+	if (pred->flags & FNM_CASEFOLD)
+	    pf.len = 0;
+	else
+#endif
+	pf.len = literal(pred->pat, pred->flags);
+	break;
+    case FRENC_PRED_SUFFIX:
+	sfxlen = strlen(pred->pat);
+	break;
+    default:
+	assert(pred->type == FRENC_PRED_FUNC);
+	assert(pred->func);
+    }
+    bool sorted = pred->flags & FRENC_PRED_SORTED;
+    // the current string, and the matching strings with their offsets
+    struct strbuf cur = { NULL, 0, 0 };
+    struct strbuf out = { NULL, 0, 0 };
+    struct strbuf off = { NULL, 0, 0 };
+    size_t ret = FRENC_ERR_DATA;
+    size_t olen = 0;
+    for (bool first = 1; p < end; first = 0) {
+	size_t len = 0;
+	if (!first) {
+	    len = getlen(&p, end, olen, 1);
+	    if (len >= FRENC_ERROR || len > cur.len)
+		goto out;
+	    olen = len;
+	}
+	size_t slen = strlen(p);
+	cur.len = len;
+	if (!reserve(&cur, slen + 1))
+	    goto nomem;
+	memcpy(cur.s + len, p, slen + 1);
+	p += slen + 1;
+	cur.len = len + slen;
+	int m;
+	switch (pred->type) {
+	case FRENC_PRED_PREFIX:
+	    m = prefix_match(&pf, cur.s, cur.len, len, sorted);
+	    break;
+	case FRENC_PRED_GLOB:
+	    m = prefix_match(&pf, cur.s, cur.len, len, sorted);
+	    if (m > 0)
+		m = fnmatch(pred->pat, cur.s, pred->flags & ~FRENC_PRED_SORTED)
+		    == 0;
+	    break;
+	case FRENC_PRED_SUFFIX:
+	    m = cur.len >= sfxlen &&
+		memcmp(cur.s + cur.len - sfxlen, pred->pat, sfxlen) == 0;
+	    break;
+	default:
+	    m = pred->func(cur.s, cur.len, len, pred->arg) != 0;
+	}
+	if (m < 0)
+	    break;
+	if (m == 0)
+	    continue;
+	if (!reserve(&out, cur.len + 1) || !reserve(&off, sizeof(size_t)))
+	    goto nomem;
+	memcpy(out.s + out.len, cur.s, cur.len + 1);
+	memcpy(off.s + off.len, &out.len, sizeof(size_t));
+	out.len += cur.len + 1;
+	off.len += sizeof(size_t);
+    }
+    // build the output, as with frdecl
+    size_t n = off.len / sizeof(size_t);
+    char **v = malloc((n + 1) * sizeof *v + n * sizeof(unsigned) + out.len);
+    if (v == NULL)
+	goto nomem;
+    unsigned *ll = (unsigned *) (v + n + 1);
+    char *strtab = (char *) (ll + n);
+    if (out.len)
+	memcpy(strtab, out.s, out.len);
+    const size_t *offv = (const size_t *) off.s;
+    for (size_t i = 0; i < n; i++) {
+	v[i] = strtab + offv[i];
+	size_t next = i + 1 < n ? offv[i+1] : out.len;
+	ll[i] = next - offv[i] - 1;
+    }
+    v[n] = NULL;
+    *vp = v;
+    if (llp)
+	*llp = ll;
+    ret = n;
+    goto out;
+nomem:
+    ret = FRENC_ERR_MALLOC;
+out:
+    free(cur.s);
+    free(out.s);
+    free(off.s);
+    return ret;
+}
@@ -0,0 +1,250 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <endian.h>
+#define FRENC_FORMAT
+#include "frenc.h"
+#include "diff.h"
+
+// The trie is built bottom-up, in the same way as the lcp-interval tree
+// is built from a suffix array: a node is open while the strings keep
+// sharing its prefix, and is closed (i.e. written out in post-order)
+// when the common prefix gets shorter than its depth.  The lengths of
+// the common prefixes come right from the encoded data, and the trie
+// is built in the same pass in which the strings are decoded (after
+// the sizing pass, as with frdecl).  The strings are only compared
+// past the common prefix: to verify that they are sorted, and to
+// extend the prefixes truncated on encoding.  While building, the
+// children are linked into lists via prev[], the last child being
+// stored in kid0; the lists are then laid out into the kid[] and kidc[]
+// arrays.
+
+struct open {
+    unsigned depth, lo, last, nkid;
+};
+
+static inline void attach(struct open *parent, unsigned k, unsigned lo,
+			  unsigned *prev, unsigned char *cc, char **v)
+{
+    prev[k] = parent->last;
+    cc[k] = v[lo][parent->depth];
+    parent->last = k;
+    parent->nkid++;
+}
+
+static inline bool push(struct open **stkp, size_t *sp, size_t *alloc,
+			unsigned depth, unsigned lo)
+{
+    if (*sp == *alloc) {
+	size_t nalloc = 2 * *alloc;
+	struct open *stk = realloc(*stkp, nalloc * sizeof *stk);
+	if (stk == NULL)
+	    return 0;
+	*stkp = stk;
+	*alloc = nalloc;
+    }
+    (*stkp)[(*sp)++] = (struct open) {
+	.depth = depth, .lo = lo, .last = FRTRIE_NONE, .nkid = 0,
+    };
+    return 1;
+}
+
+// The sizing pass, as in frdecl: validate the data, and compute
+// the number of strings and the total size of the strings.
+static size_t sizepass(const char *p, const char *end, size_t *strtab_size)
+{
+    size_t n = 1;
+    size_t len = strlen(p);
+    *strtab_size = len + 1;
+    p += len + 1;
+    // the length of the previous string, which the prefix cannot exceed
+    size_t plen = len;
+    size_t olen = 0;
+    while (p < end) {
+	len = getlen(&p, end, olen, 1);
+	if (UNLIKELY(len >= FRENC_ERROR))
+	    return len;
+	if (UNLIKELY(len > plen))
+	    return FRENC_ERR_DATA;
+	olen = len;
+	size_t slen = strlen(p);
+	plen = len + slen;
+	*strtab_size += len + slen + 1;
+	p += slen + 1;
+	n++;
+    }
+    return n;
+}
+
+size_t frdec_trie(const void *enc, size_t encsize, struct frtrie **tp)
+{
+    assert(encsize > 0);
+    assert(enc);
+    assert(tp);
+    const char *p = enc;
+    const char *end = p + encsize;
+    if (end[-1] != '\0')
+	return FRENC_ERR_DATA;
+    size_t strtab_size;
+    size_t n = sizepass(p, end, &strtab_size);
+    if (n >= FRENC_ERROR)
+	return n;
+    // each string adds at most one leaf and one branching node
+    size_t maxnodes = 2 * n + 1;
+    if (maxnodes >= FRTRIE_NONE)
+	return FRENC_ERR_RANGE;
+    // the strings are laid out as with frdecl
+    char **v = malloc((n + 1) * sizeof *v + n * sizeof(unsigned) +
+		      strtab_size);
+    struct frtrie *t = malloc(sizeof *t + maxnodes *
+			      (sizeof *t->nodes + sizeof *t->kid + 1));
+    unsigned *prev = malloc(maxnodes * (sizeof *prev + 1));
+    size_t alloc = 64;
+    struct open *stk = malloc(alloc * sizeof *stk);
+    size_t ret = FRENC_ERR_MALLOC;
+    if (v == NULL || t == NULL || prev == NULL || stk == NULL)
+	goto fail;
+    unsigned *ll = (unsigned *) (v + n + 1);
+    char *strtab = (char *) (ll + n);
+    unsigned char *cc = (unsigned char *) (prev + maxnodes);
+    struct frtrie_node *nodes = t->nodes;
+    size_t nn = 0;
+    size_t sp = 0;
+    push(&stk, &sp, &alloc, 0, 0);
+    size_t olen = 0;
+    for (size_t i = 0; i <= n; i++) {
+	size_t L = 0;
+	if (i < n) {
+	    // decode the string
+	    size_t len = i ? getlen(&p, end, olen, 0) : 0;
+	    olen = len;
+	    v[i] = strtab;
+	    if (i)
+		memcpy(strtab, v[i-1], len);
+	    size_t slen = stpcpy(strtab + len, p) - (strtab + len);
+	    p += slen + 1;
+	    ll[i] = len + slen;
+	    strtab += ll[i] + 1;
+	}
+	if (i > 0 && i < n) {
+	    // the prefix could have been cut on encoding, if it was too
+	    // much longer than the previous one
+	    L = olen;
+	    const char *s0 = v[i-1], *s1 = v[i];
+	    while (L < ll[i] && L < ll[i-1] && s0[L] == s1[L])
+		L++;
+	    // the strings must be sorted, byte-wise
+	    if (L < ll[i-1] && (L == ll[i] ||
+		(unsigned char) s1[L] < (unsigned char) s0[L])) {
+		ret = FRENC_ERR_DATA;
+		goto fail;
+	    }
+	}
+	// close the nodes deeper than the common prefix
+	while (stk[sp-1].depth > L || i == n) {
+	    unsigned k = nn++;
+	    struct open *o = &stk[--sp];
+	    nodes[k] = (struct frtrie_node) {
+		.depth = o->depth, .lo = o->lo, .hi = i,
+		.kid0 = o->last, .nkid = o->nkid,
+	    };
+	    if (sp == 0)
+		break;
+	    if (stk[sp-1].depth < L) {
+		// the new branching node, to which the string i will go
+		if (!push(&stk, &sp, &alloc, L, nodes[k].lo))
+		    goto fail;
+	    }
+	    attach(&stk[sp-1], k, nodes[k].lo, prev, cc, v);
+	}
+	if (i == n)
+	    break;
+	// the string ends in a new leaf, unless it ends at the open node
+	// (which happens with duplicates and the empty string)
+	if (ll[i] > stk[sp-1].depth && !push(&stk, &sp, &alloc, ll[i], i))
+	    goto fail;
+    }
+    v[n] = NULL;
+    // lay out the children
+    t->kid = (unsigned *) (nodes + maxnodes);
+    t->kidc = (unsigned char *) (t->kid + maxnodes);
+    size_t off = 0;
+    for (size_t k = 0; k < nn; k++) {
+	unsigned j = nodes[k].kid0;
+	nodes[k].kid0 = off;
+	off += nodes[k].nkid;
+	for (size_t pos = off; j != FRTRIE_NONE; j = prev[j]) {
+	    t->kid[--pos] = j;
+	    t->kidc[pos] = cc[j];
+	}
+    }
+    free(stk);
+    free(prev);
+    t->n = n;
+    t->v = v;
+    t->ll = ll;
+    t->nnodes = nn;
+    *tp = t;
+    return n;
+fail:
+    free(stk);
+    free(prev);
+    free(t);
+    free(v);
+    return ret;
+}
+
+void frtrie_free(struct frtrie *t)
+{
+    if (t == NULL)
+	return;
+    free(t->v);
+    free(t);
+}
+
+// Descend to the highest node whose depth is at least len, comparing
+// only the first byte of each edge.  The rest of the edge bytes are
+// verified once at the end (this is how patricia tries work).
+static inline unsigned descend(const struct frtrie *t,
+			       const char *s, size_t len)
+{
+    const struct frtrie_node *nodes = t->nodes;
+    unsigned k = t->nnodes - 1;
+    while (nodes[k].depth < len) {
+	const unsigned char *kc = t->kidc + nodes[k].kid0;
+	const unsigned char *q = memchr(kc, s[nodes[k].depth], nodes[k].nkid);
+	if (q == NULL)
+	    return FRTRIE_NONE;
+	k = t->kid[nodes[k].kid0 + (q - kc)];
+    }
+    if (memcmp(t->v[nodes[k].lo], s, len) != 0)
+	return FRTRIE_NONE;
+    return k;
+}
+
+size_t frtrie_find(const struct frtrie *t, const char *s, size_t len)
+{
+    assert(t);
+    unsigned k = descend(t, s, len);
+    if (k == FRTRIE_NONE)
+	return t->n;
+    size_t lo = t->nodes[k].lo;
+    if (t->ll[lo] != len)
+	return t->n;
+    return lo;
+}
+
+size_t frtrie_prefix(const struct frtrie *t, const char *s, size_t len,
+		     size_t *hip)
+{
+    assert(t);
+    assert(hip);
+    unsigned k = descend(t, s, len);
+    if (k == FRTRIE_NONE)
+	return *hip = 0;
+    *hip = t->nodes[k].hi;
+    return t->nodes[k].lo;
+}
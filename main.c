@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <assert.h>
 #include "frenc.h"
 
@@ -12,12 +13,20 @@
 int main(int argc, char **argv)
 {
     bool dec = 0;
+    bool sfx = 0;
+    char delim = '\n';
     int opt;
-    while ((opt = getopt(argc, argv, "d")) != -1) {
+    while ((opt = getopt(argc, argv, "dsz")) != -1) {
 	switch (opt) {
 	case 'd':
 	    dec = 1;
 	    break;
+	case 's':
+	    sfx = 1;
+	    break;
+	case 'z':
+	    delim = '\0';
+	    break;
 	default:
 	    goto usage;
 	}
@@ -25,7 +34,7 @@ int main(int argc, char **argv)
 #define progname argv[0]
     if (argc > optind + 1) {
 	fprintf(stderr, "%s: too many arguments\n", progname);
-usage:	fprintf(stderr, "Usage: %s [-d] [file]\n", progname);
+usage:	fprintf(stderr, "Usage: %s [-dsz] [file]\n", progname);
 	return 1;
     }
     if (argc > optind && strcmp(argv[optind], "-") != 0) {
@@ -53,26 +62,39 @@ usage:	fprintf(stderr, "Usage: %s [-d] [file]\n", progname);
 empty:	    fprintf(stderr, "%s: empty input\n", progname);
 	    return 1;
 	}
-	unsigned *lens;
-	n = frdecl(buf, size, &v, &lens);
-	free(buf);
-	if (n >= FRENC_ERROR) {
+	// render the text in one go, no need for v[] and per-line stdio
+	size_t (*dec_text)(const void *, size_t, char, char *) =
+		sfx ? frdec_sfx_text : frdec_text;
+	size_t text_size = dec_text(buf, size, delim, NULL);
+	if (text_size >= FRENC_ERROR) {
 	    fprintf(stderr, "%s: frdec failed\n", progname);
 	    return 1;
 	}
-	assert(v);
-	for (size_t i = 0; i < n; i++) {
-	    v[i][lens[i]] = '\n';
-	    fwrite(v[i], lens[i] + 1, 1, stdout);
+	char *text = malloc(text_size);
+	assert(text);
+	dec_text(buf, size, delim, text);
+	free(buf);
+	const char *p = text;
+	while (text_size) {
+	    ssize_t m = write(STDOUT_FILENO, p, text_size);
+	    if (m < 0) {
+		if (errno == EINTR)
+		    continue;
+		fprintf(stderr, "%s: write failed\n", progname);
+		return 1;
+	    }
+	    p += m;
+	    text_size -= m;
 	}
+	free(text);
 	return 0;
     }
     // encode
     char *line = NULL;
     size_t alloc_size = 0;
     ssize_t len;
-    while ((len = getline(&line, &alloc_size, stdin)) >= 0) {
-	if (len > 0 && line[len-1] == '\n')
+    while ((len = getdelim(&line, &alloc_size, delim, stdin)) >= 0) {
+	if (len > 0 && line[len-1] == delim)
 	    line[--len] = '\0';
 	if ((n % 1024) == 0)
 	    v = realloc(v, sizeof(*v) * (n + 1024));
@@ -84,7 +106,7 @@ empty:	    fprintf(stderr, "%s: empty input\n", progname);
     if (n == 0)
 	goto empty;
     void *enc;
-    size_t size = frenc(v, n, &enc);
+    size_t size = sfx ? frenc_sfx(v, n, &enc) : frenc(v, n, &enc);
     if (size >= FRENC_ERROR) {
 	fprintf(stderr, "%s: frenc failed\n", progname);
 	return 1;